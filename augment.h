@@ -0,0 +1,323 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include "mnist.h"
+
+namespace augment
+{
+    // Small counter-seeded generator (splitmix64). Unlike the std distributions its output is
+    // identical across standard libraries, so augmented samples only depend on the seed.
+    class SplitMix64
+    {
+    public:
+        explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        // uniform float in [min, max)
+        float uniform(float min, float max)
+        {
+            return min + (max - min) * ((next() >> 40) * (1.0f / 16777216.0f));
+        }
+
+    private:
+        uint64_t state;
+    };
+
+    struct Params
+    {
+        float maxShift = 2.0f;            // pixels, each axis
+        float maxRotationDegrees = 10.0f; // either direction
+        float elasticAlpha = 34.0f;       // displacement scale (Simard et al. 2003)
+        float elasticSigma = 4.0f;        // gaussian smoothing of the displacement field
+    };
+
+    // Applies a random shift, rotation and elastic distortion to one image.
+    // All three are folded into a single inverse mapping followed by one bilinear resample.
+    // Holds scratch buffers, so each worker thread needs its own instance.
+    class Augmenter
+    {
+    public:
+        Augmenter(int numRows, int numCols, const Params &params)
+            : numRows(numRows), numCols(numCols), params(params)
+        {
+            radius = std::max(1, (int)std::ceil(3.0f * params.elasticSigma));
+            kernel.resize(2 * radius + 1);
+            float total = 0.0f;
+            for (int t = -radius; t <= radius; t++)
+            {
+                kernel[t + radius] = std::exp(-(t * t) / (2.0f * params.elasticSigma * params.elasticSigma));
+                total += kernel[t + radius];
+            }
+            for (float &k : kernel)
+            {
+                k /= total;
+            }
+
+            // noise is drawn on a grid padded by the kernel radius so the blur needs no border handling
+            noiseCols = numCols + 2 * radius;
+            noiseRows = numRows + 2 * radius;
+            noise.resize(noiseRows * noiseCols);
+            blurred.resize(noiseRows * numCols);
+            dx.resize(numRows * numCols);
+            dy.resize(numRows * numCols);
+
+            // source copy with a zero border (1 before, 2 after) so bilinear taps never branch
+            paddedCols = numCols + 3;
+            padded.assign((numRows + 3) * paddedCols, 0.0f);
+        }
+
+        void apply(const unsigned char *source, unsigned char *destination, uint64_t seed)
+        {
+            SplitMix64 rng(seed);
+            const float angle = rng.uniform(-params.maxRotationDegrees, params.maxRotationDegrees) * 3.14159265f / 180.0f;
+            const float shiftX = rng.uniform(-params.maxShift, params.maxShift);
+            const float shiftY = rng.uniform(-params.maxShift, params.maxShift);
+            displacementField(rng, dx);
+            displacementField(rng, dy);
+
+            for (int y = 0; y < numRows; y++)
+            {
+                float *row = &padded[(y + 1) * paddedCols + 1];
+                const unsigned char *sourceRow = source + y * numCols;
+                for (int x = 0; x < numCols; x++)
+                {
+                    row[x] = sourceRow[x];
+                }
+            }
+
+            const float cosA = std::cos(angle);
+            const float sinA = std::sin(angle);
+            const float cx = (numCols - 1) * 0.5f;
+            const float cy = (numRows - 1) * 0.5f;
+            for (int y = 0; y < numRows; y++)
+            {
+                const float v = y - cy - shiftY;
+                const float *dxRow = &dx[y * numCols];
+                const float *dyRow = &dy[y * numCols];
+                unsigned char *out = destination + y * numCols;
+                for (int x = 0; x < numCols; x++)
+                {
+                    const float u = x - cx - shiftX;
+                    float sx = cosA * u + sinA * v + cx + dxRow[x];
+                    float sy = -sinA * u + cosA * v + cy + dyRow[x];
+                    sx = std::min(std::max(sx, -1.0f), (float)numCols);
+                    sy = std::min(std::max(sy, -1.0f), (float)numRows);
+
+                    const float fx0 = std::floor(sx);
+                    const float fy0 = std::floor(sy);
+                    const float fx = sx - fx0;
+                    const float fy = sy - fy0;
+                    const float *p = &padded[((int)fy0 + 1) * paddedCols + (int)fx0 + 1];
+                    const float top = p[0] + fx * (p[1] - p[0]);
+                    const float bottom = p[paddedCols] + fx * (p[paddedCols + 1] - p[paddedCols]);
+                    const float value = top + fy * (bottom - top);
+                    out[x] = (unsigned char)std::min(255.0f, std::max(0.0f, value + 0.5f));
+                }
+            }
+        }
+
+    private:
+        int numRows;
+        int numCols;
+        Params params;
+
+        int radius;
+        int noiseRows;
+        int noiseCols;
+        int paddedCols;
+        std::vector<float> kernel;
+        std::vector<float> noise;
+        std::vector<float> blurred;
+        std::vector<float> dx;
+        std::vector<float> dy;
+        std::vector<float> padded;
+
+        // uniform noise in [-1, 1), gaussian blurred (separable, row-major passes) and scaled by alpha
+        void displacementField(SplitMix64 &rng, std::vector<float> &field)
+        {
+            for (float &n : noise)
+            {
+                n = rng.uniform(-1.0f, 1.0f);
+            }
+
+            // horizontal pass: (noiseRows, noiseCols) -> (noiseRows, numCols)
+            std::fill(blurred.begin(), blurred.end(), 0.0f);
+            for (int y = 0; y < noiseRows; y++)
+            {
+                float *out = &blurred[y * numCols];
+                const float *in = &noise[y * noiseCols];
+                for (int t = 0; t <= 2 * radius; t++)
+                {
+                    const float k = kernel[t];
+                    for (int x = 0; x < numCols; x++)
+                    {
+                        out[x] += k * in[x + t];
+                    }
+                }
+            }
+
+            // vertical pass: (noiseRows, numCols) -> (numRows, numCols)
+            std::fill(field.begin(), field.end(), 0.0f);
+            for (int y = 0; y < numRows; y++)
+            {
+                float *out = &field[y * numCols];
+                for (int t = 0; t <= 2 * radius; t++)
+                {
+                    const float k = kernel[t] * params.elasticAlpha;
+                    const float *in = &blurred[(y + t) * numCols];
+                    for (int x = 0; x < numCols; x++)
+                    {
+                        out[x] += k * in[x];
+                    }
+                }
+            }
+        }
+    };
+
+    // Produces a stream of augmented samples on worker threads, ahead of the trainer.
+    // Sample n is augmented from image (n % numSources) with a seed derived from (seed, n),
+    // so the stream is identical for a given seed regardless of the number of threads.
+    class AugmentedStream
+    {
+    public:
+        struct Stats
+        {
+            unsigned long produced = 0; // samples augmented so far
+            double workerSeconds = 0;   // time spent augmenting, summed over workers
+            double waitSeconds = 0;     // time the consumer spent waiting for a sample
+        };
+
+        AugmentedStream(const mnist::MNISTImages &images, unsigned int numSources, unsigned long numSamples,
+                        uint64_t seed, unsigned int numThreads, const Params &params = Params())
+            : images(images), numSources(std::min<unsigned int>(numSources, images.numImages)), numSamples(numSamples), seed(seed)
+        {
+            if (this->numSources == 0)
+            {
+                throw std::invalid_argument("AugmentedStream needs at least one source image");
+            }
+
+            numThreads = std::max(1u, numThreads);
+            imageSize = images.numRows * images.numCols;
+            capacity = 64 * numThreads;
+            slots.resize(capacity * imageSize);
+            ready.assign(capacity, 0);
+
+            for (unsigned int i = 0; i < numThreads; i++)
+            {
+                workers.emplace_back(&AugmentedStream::work, this, params);
+            }
+        }
+
+        ~AugmentedStream()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            spaceAvailable.notify_all();
+            for (std::thread &worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        // Copy the next sample into `image` and return the index of the image it was augmented from
+        unsigned int next(std::vector<unsigned char> &image)
+        {
+            if (consumed >= numSamples)
+            {
+                throw std::out_of_range("AugmentedStream is exhausted");
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock(mutex);
+            unsigned int slot = consumed % capacity;
+            sampleReady.wait(lock, [this, slot]
+                             { return ready[slot] != 0; });
+            stats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            image.assign(slots.begin() + slot * imageSize, slots.begin() + (slot + 1) * imageSize);
+            unsigned int source = consumed % numSources;
+            ready[slot] = 0;
+            consumed++;
+            lock.unlock();
+            spaceAvailable.notify_all();
+            return source;
+        }
+
+        Stats getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        const mnist::MNISTImages &images;
+        const unsigned int numSources;
+        const unsigned long numSamples;
+        const uint64_t seed;
+        unsigned int imageSize;
+        unsigned int capacity;
+
+        std::mutex mutex;
+        std::condition_variable spaceAvailable;
+        std::condition_variable sampleReady;
+        std::vector<unsigned char> slots; // ring buffer of `capacity` images
+        std::vector<char> ready;
+        unsigned long nextSample = 0;
+        unsigned long consumed = 0;
+        bool stopping = false;
+        Stats stats;
+        std::vector<std::thread> workers;
+
+        void work(Params params)
+        {
+            Augmenter augmenter(images.numRows, images.numCols, params);
+            while (true)
+            {
+                unsigned long n;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (stopping || nextSample >= numSamples)
+                    {
+                        return;
+                    }
+                    n = nextSample++;
+                    spaceAvailable.wait(lock, [this, n]
+                                        { return stopping || n < consumed + capacity; });
+                    if (stopping)
+                    {
+                        return;
+                    }
+                }
+
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                unsigned int slot = n % capacity;
+                augmenter.apply(images.images[n % numSources].data(), &slots[slot * imageSize],
+                                SplitMix64(seed ^ (n * 0xD1B54A32D192ED03ULL)).next());
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ready[slot] = 1;
+                    stats.produced++;
+                    stats.workerSeconds += seconds;
+                }
+                sampleReady.notify_one();
+            }
+        }
+    };
+}
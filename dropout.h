@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+#include "mlmath.h"
+
+namespace dropout
+{
+    // Philox4x32-10 (Salmon et al. 2011): a counter-based generator, the output is a pure function
+    // of (counter, key). Masks can therefore be generated for any sample, on any thread, in any order.
+    inline void philox4x32(uint32_t counter[4], uint32_t key0, uint32_t key1)
+    {
+        for (int round = 0; round < 10; round++)
+        {
+            const uint64_t product0 = (uint64_t)0xD2511F53u * counter[0];
+            const uint64_t product1 = (uint64_t)0xCD9E8D57u * counter[2];
+            const uint32_t c1 = counter[1];
+            const uint32_t c3 = counter[3];
+            counter[0] = (uint32_t)(product1 >> 32) ^ c1 ^ key0;
+            counter[1] = (uint32_t)product1;
+            counter[2] = (uint32_t)(product0 >> 32) ^ c3 ^ key1;
+            counter[3] = (uint32_t)product0;
+            key0 += 0x9E3779B9u;
+            key1 += 0xBB67AE85u;
+        }
+    }
+
+    // Bit-packed dropout mask for one sample's hidden layer, bit j set means unit j is kept
+    class Mask
+    {
+    public:
+        const unsigned int size;
+        const double scale; // kept units are scaled by 1 / keep probability (inverted dropout)
+
+        Mask(unsigned int size, double dropProbability, uint64_t seed)
+            : size(size), scale(1.0 / (1.0 - dropProbability)), seed(seed), bits((size + 63) / 64, 0)
+        {
+            if (dropProbability < 0.0 || dropProbability >= 1.0)
+            {
+                throw std::invalid_argument("Dropout probability must be in [0, 1)");
+            }
+            keepThreshold = (uint64_t)((1.0 - dropProbability) * 4294967296.0);
+        }
+
+        // Fill the mask for one sample: unit j uses the j-th 32-bit Philox output for counter (j / 4, sample)
+        void generate(uint64_t sample)
+        {
+            std::fill(bits.begin(), bits.end(), 0);
+            for (unsigned int block = 0; block * 4 < size; block++)
+            {
+                uint32_t counter[4] = {block, (uint32_t)sample, (uint32_t)(sample >> 32), 0};
+                philox4x32(counter, (uint32_t)seed, (uint32_t)(seed >> 32));
+                for (unsigned int lane = 0; lane < 4 && block * 4 + lane < size; lane++)
+                {
+                    const unsigned int unit = block * 4 + lane;
+                    bits[unit / 64] |= (uint64_t)(counter[lane] < keepThreshold) << (unit % 64);
+                }
+            }
+        }
+
+        bool keep(unsigned int unit) const
+        {
+            return (bits[unit / 64] >> (unit % 64)) & 1;
+        }
+
+    private:
+        const uint64_t seed;
+        uint64_t keepThreshold;
+        std::vector<uint64_t> bits;
+    };
+
+    // Fused relu + dropout in place: layer_1 = relu(layer_1) * mask * scale, Shape (1, hidden)
+    inline void reluForward(mlmath::Matrix &layer_1, const Mask &mask)
+    {
+        std::vector<double> &row = layer_1.data[0];
+        for (unsigned int j = 0; j < mask.size; j++)
+        {
+            row[j] = (mask.keep(j) && row[j] > 0) ? row[j] * mask.scale : 0.0;
+        }
+    }
+
+    // Fused relu derivative + dropout in place: delta *= relu_derivative(layer_1) * mask * scale
+    inline void reluBackward(mlmath::Matrix &layer_1_delta, const mlmath::Matrix &layer_1, const Mask &mask)
+    {
+        std::vector<double> &row = layer_1_delta.data[0];
+        const std::vector<double> &activations = layer_1.data[0];
+        for (unsigned int j = 0; j < mask.size; j++)
+        {
+            row[j] = (mask.keep(j) && activations[j] > 0) ? row[j] * mask.scale : 0.0;
+        }
+    }
+}
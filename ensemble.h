@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include "mlmath.h"
+#include "network.h"
+
+namespace nn
+{
+    // K independently initialized copies of the main.cpp network trained in lockstep.
+    // The first layers are concatenated into one wide (pixels, K * hidden) matrix, so every
+    // input pixel is loaded once per sample and multiplied against one contiguous row;
+    // the hidden activations are then split into K slices for the per-model second layers.
+    class Ensemble
+    {
+    public:
+        const unsigned int numModels;
+        const unsigned int hiddenLayerSize;
+        mlmath::Matrix weights_0_1;               // Shape (pixels, numModels * hiddenLayerSize)
+        std::vector<mlmath::Matrix> weights_1_2; // numModels x Shape (hiddenLayerSize, labels)
+
+        Ensemble(unsigned int numModels, unsigned int pixelsPerImage, unsigned int hiddenLayerSize, unsigned int numLabels)
+            : numModels(numModels), hiddenLayerSize(hiddenLayerSize), weights_0_1(pixelsPerImage, numModels * hiddenLayerSize)
+        {
+            for (unsigned int m = 0; m < numModels; m++)
+            {
+                // same initialization as a single Network, each model drawing its own weights
+                Network model(pixelsPerImage, hiddenLayerSize, numLabels);
+                for (unsigned int k = 0; k < pixelsPerImage; k++)
+                {
+                    std::copy(model.weights_0_1.data[k].begin(), model.weights_0_1.data[k].end(),
+                              weights_0_1.data[k].begin() + m * hiddenLayerSize);
+                }
+                weights_1_2.push_back(model.weights_1_2);
+            }
+        }
+
+        // One SGD step of every model on the same sample, returns each model's output, Shape (1, labels)
+        std::vector<mlmath::Matrix> train(const std::vector<double> &layer_0, const mlmath::Matrix &target, double alpha)
+        {
+            std::vector<double> layer_1 = hidden(layer_0); // Shape (1, numModels * hiddenLayerSize)
+            std::vector<double> layer_1_delta(layer_1.size());
+            std::vector<mlmath::Matrix> outputs;
+
+            for (unsigned int m = 0; m < numModels; m++)
+            {
+                mlmath::Matrix layer_1_m = slice(layer_1, m);             // Shape (1, hidden)
+                mlmath::Matrix layer_2 = layer_1_m * weights_1_2[m];      // Shape (1, 10)
+                mlmath::Matrix layer_2_delta = layer_2 - target;          // Shape (1, 10)
+                mlmath::Matrix layer_1_m_delta = (layer_2_delta * weights_1_2[m].transpose()) // Shape (1, hidden)
+                                                     .elementWiseMultiply(mlmath::relu_derivative(layer_1_m));
+
+                std::copy(layer_1_m_delta.data[0].begin(), layer_1_m_delta.data[0].end(),
+                          layer_1_delta.begin() + m * hiddenLayerSize);
+                weights_1_2[m] -= (layer_1_m.transpose() * layer_2_delta) * alpha; // Shape (hidden, 10)
+                outputs.push_back(layer_2);
+            }
+
+            // wide outer-product update, rows of zero pixels have no gradient
+            for (unsigned int k = 0; k < layer_0.size(); k++)
+            {
+                if (layer_0[k] == 0.0)
+                {
+                    continue;
+                }
+                const double scale = layer_0[k] * alpha;
+                std::vector<double> &row = weights_0_1.data[k];
+                for (unsigned int j = 0; j < row.size(); j++)
+                {
+                    row[j] -= scale * layer_1_delta[j];
+                }
+            }
+            return outputs;
+        }
+
+        // Outputs of every model for one normalized image, each Shape (1, labels)
+        std::vector<mlmath::Matrix> predict(const std::vector<double> &layer_0) const
+        {
+            std::vector<double> layer_1 = hidden(layer_0);
+            std::vector<mlmath::Matrix> outputs;
+            for (unsigned int m = 0; m < numModels; m++)
+            {
+                outputs.push_back(slice(layer_1, m) * weights_1_2[m]);
+            }
+            return outputs;
+        }
+
+    private:
+        // relu(layer_0 * weights_0_1) with the pixel loop outermost, skipping zero pixels
+        std::vector<double> hidden(const std::vector<double> &layer_0) const
+        {
+            std::vector<double> layer_1(weights_0_1.shape.cols, 0.0);
+            for (unsigned int k = 0; k < layer_0.size(); k++)
+            {
+                if (layer_0[k] == 0.0)
+                {
+                    continue;
+                }
+                const double pixel = layer_0[k];
+                const std::vector<double> &row = weights_0_1.data[k];
+                for (unsigned int j = 0; j < row.size(); j++)
+                {
+                    layer_1[j] += pixel * row[j];
+                }
+            }
+            return mlmath::relu(layer_1);
+        }
+
+        mlmath::Matrix slice(const std::vector<double> &layer_1, unsigned int model) const
+        {
+            mlmath::Matrix result(1, hiddenLayerSize);
+            std::copy(layer_1.begin() + model * hiddenLayerSize, layer_1.begin() + (model + 1) * hiddenLayerSize,
+                      result.data[0].begin());
+            return result;
+        }
+    };
+}
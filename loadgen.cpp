@@ -0,0 +1,158 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "mnist.h"
+#include "serving.h"
+
+// Closed-loop load generator for mnist_server: each connection sends one image,
+// waits for the reply, and sends the next. Reports throughput and latency percentiles
+// for every concurrency level.
+
+// p-th percentile of an ascending sorted sample (nearest-rank)
+double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void runClient(const std::string &socketPath, const std::vector<std::vector<unsigned char>> &images,
+               unsigned int firstImage, unsigned int numRequests, std::vector<double> &latencies)
+{
+    int fd = -1;
+    try
+    {
+        fd = serving::connectUnix(socketPath);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
+
+    unsigned char buffer[serving::responseBytes];
+
+    for (unsigned int i = 0; i < numRequests; i++)
+    {
+        const std::vector<unsigned char> &image = images[(firstImage + i) % images.size()];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!serving::writeFully(fd, image.data(), image.size()) || !serving::readFully(fd, buffer, sizeof(buffer)))
+        {
+            std::cerr << "Connection to server lost" << std::endl;
+            break;
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    ::close(fd);
+}
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--socket PATH] [--images PATH] [--requests N] [--concurrency 1,4,16,...]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = serving::defaultSocketPath;
+    std::string imagesPath;
+    unsigned int numRequests = 20000;
+    std::vector<unsigned int> concurrencyLevels = {1, 2, 4, 8, 16, 32, 64};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (arg == "--socket")
+            socketPath = argv[++i];
+        else if (arg == "--images")
+            imagesPath = argv[++i];
+        else if (arg == "--requests")
+            numRequests = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--concurrency")
+        {
+            concurrencyLevels.clear();
+            std::stringstream levels(argv[++i]);
+            std::string level;
+            while (std::getline(levels, level, ','))
+            {
+                concurrencyLevels.push_back(std::max(1, std::atoi(level.c_str())));
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // real MNIST images if given, otherwise a fixed set of random images
+    std::vector<std::vector<unsigned char>> images;
+    if (!imagesPath.empty())
+    {
+        images = mnist::MNISTImages(imagesPath).images;
+    }
+    else
+    {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int> dis(0, 255);
+        images.resize(1000, std::vector<unsigned char>(serving::imageBytes));
+        for (std::vector<unsigned char> &image : images)
+        {
+            for (unsigned char &pixel : image)
+            {
+                pixel = (unsigned char)dis(gen);
+            }
+        }
+    }
+
+    std::cout << std::setw(12) << "Concurrency" << std::setw(12) << "Requests" << std::setw(14) << "Req/s"
+              << std::setw(12) << "p50 (us)" << std::setw(12) << "p99 (us)" << std::setw(12) << "p999 (us)" << std::endl;
+
+    for (unsigned int concurrency : concurrencyLevels)
+    {
+        std::vector<std::vector<double>> latencies(concurrency);
+        std::vector<std::thread> clients;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned int c = 0; c < concurrency; c++)
+        {
+            // spread the requests evenly, the first clients take the remainder
+            unsigned int share = numRequests / concurrency + (c < numRequests % concurrency ? 1 : 0);
+            clients.emplace_back(runClient, std::cref(socketPath), std::cref(images), c * 7919, share, std::ref(latencies[c]));
+        }
+        for (std::thread &client : clients)
+        {
+            client.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const std::vector<double> &clientLatencies : latencies)
+        {
+            all.insert(all.end(), clientLatencies.begin(), clientLatencies.end());
+        }
+        if (all.empty())
+        {
+            std::cerr << "No requests completed at concurrency " << concurrency << std::endl;
+            return 1;
+        }
+        std::sort(all.begin(), all.end());
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(12) << concurrency << std::setw(12) << all.size() << std::setw(14) << all.size() / seconds
+                  << std::setw(12) << percentile(all, 0.50) << std::setw(12) << percentile(all, 0.99)
+                  << std::setw(12) << percentile(all, 0.999) << std::endl;
+    }
+    return 0;
+}
@@ -1,7 +1,15 @@
 #include <iostream>
 #include "mnist.h"
 #include "mlmath.h"
+#include "network.h"
+#include "augment.h"
+#include "ensemble.h"
+#include "dropout.h"
 #include <math.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstdlib>
 
 // define function that convert images to vector of mlm::Matrix
 std::vector<mlmath::Matrix> imagesToMatrix(const mnist::MNISTImages &images)
@@ -39,8 +47,105 @@ std::vector<mlmath::Matrix> oneHot(const mnist::MNISTLabels &labels)
     return result;
 }
 
-int main()
+// convert one raw image to a normalized row vector, Shape (1, pixels)
+mlmath::Matrix pixelsToRow(const std::vector<unsigned char> &pixels)
 {
+    mlmath::Matrix matrix(1, pixels.size());
+    for (unsigned int j = 0; j < pixels.size(); j++)
+    {
+        matrix.data[0][j] = pixels[j] / 255.0;
+    }
+    return matrix;
+}
+
+// one SGD step of the network on a single sample, returns the output layer, Shape (1, 10)
+// with a dropout mask the relu and its derivative are fused with the mask application
+mlmath::Matrix trainSample(nn::Network &network, const mlmath::Matrix &layer_0, const mlmath::Matrix &target, double alpha,
+                           const dropout::Mask *mask = nullptr)
+{
+    mlmath::Matrix &weights_0_1 = network.weights_0_1; // Shape (784, 40)
+    mlmath::Matrix &weights_1_2 = network.weights_1_2; // Shape (40, 10)
+
+    // Forward pass
+    mlmath::Matrix layer_1 = layer_0 * weights_0_1; // Shape (1, 40)
+    if (mask)
+        dropout::reluForward(layer_1, *mask);
+    else
+        layer_1 = mlmath::relu(layer_1);
+    mlmath::Matrix layer_2 = layer_1 * weights_1_2; // Shape (1, 10)
+
+    // Backpropagation
+    mlmath::Matrix layer_2_delta = layer_2 - target;                         // Shape (1, 10)
+    mlmath::Matrix layer_1_delta = layer_2_delta * weights_1_2.transpose(); // Shape (1, 40)
+    if (mask)
+        dropout::reluBackward(layer_1_delta, layer_1, *mask);
+    else
+        layer_1_delta = layer_1_delta.elementWiseMultiply(mlmath::relu_derivative(layer_1));
+
+    // Weight updates
+    weights_1_2 -= (layer_1.transpose() * layer_2_delta) * alpha; // Shape (40, 10)
+    weights_0_1 -= (layer_0.transpose() * layer_1_delta) * alpha; // Shape (784, 40)
+    return layer_2;
+}
+
+// normalize one raw image into an existing buffer, the pixels are read once for all ensemble models
+void normalizePixels(const std::vector<unsigned char> &pixels, std::vector<double> &layer_0)
+{
+    for (unsigned int j = 0; j < pixels.size(); j++)
+    {
+        layer_0[j] = pixels[j] / 255.0;
+    }
+}
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--augment SAMPLES_PER_EPOCH] [--augment-threads N] [--seed N] [--ensemble K] [--dropout P]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int augmentedPerEpoch = 0; // 0 trains on the raw images only
+    unsigned int augmentThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned long seed = 1;
+    int ensembleSize = 0; // 0 trains a single network
+    double dropProbability = 0.0; // hidden layer dropout, 0 disables it
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (arg == "--augment")
+            augmentedPerEpoch = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--augment-threads")
+            augmentThreads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed")
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--ensemble")
+            ensembleSize = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--dropout")
+            dropProbability = std::atof(argv[++i]);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (dropProbability < 0.0 || dropProbability >= 1.0)
+    {
+        std::cerr << "--dropout must be in [0, 1)" << std::endl;
+        return 1;
+    }
+    if (dropProbability > 0.0 && ensembleSize > 0)
+    {
+        std::cerr << "--dropout is only supported for single network training" << std::endl;
+        return 1;
+    }
 
     const std::string trainImagesPath = "dataset/train-images.idx3-ubyte";
     const std::string trainLabelsPath = "dataset/train-labels.idx1-ubyte";
@@ -57,43 +162,233 @@ int main()
     const int pixelsPerImage = rowImages.numRows * rowImages.numCols;
     const int numLabels = 10;
     const int trainTestSize = 1000;
+    const int samplesPerEpoch = augmentedPerEpoch > 0 ? augmentedPerEpoch : trainTestSize;
 
     std::cout << "Check training args: " << std::endl;
     std::cout << "Alpha: " << alpha << " Epochs: " << epochs << " Hidden Layer Size: " << hiddenLayerSize << " Pixels Per Image: " << pixelsPerImage << " Num Labels: " << numLabels << std::endl;
 
-    mlmath::Matrix weights_0_1 = mlmath::Matrix::random(pixelsPerImage, hiddenLayerSize, -0.1, 0.1); // Shape (784, 40)
-    mlmath::Matrix weights_1_2 = mlmath::Matrix::random(hiddenLayerSize, numLabels, -0.1, 0.1);      // Shape (40, 10)
+    // augmented samples are generated on worker threads while the trainer runs, cycling over the first trainTestSize images
+    std::unique_ptr<augment::AugmentedStream> augmented;
+    std::vector<unsigned char> augmentedPixels;
+    if (augmentedPerEpoch > 0)
+    {
+        augmented.reset(new augment::AugmentedStream(rowImages, trainTestSize, (unsigned long)epochs * samplesPerEpoch, seed, augmentThreads));
+        std::cout << "Augmentation: " << samplesPerEpoch << " samples per epoch from " << trainTestSize << " images, Threads: " << augmentThreads << " Seed: " << seed << std::endl;
+    }
+
+    if (ensembleSize > 0)
+    {
+        // K models in lockstep over one shuffled sample stream, sharing the input pixels of every sample
+        nn::Ensemble ensemble(ensembleSize, pixelsPerImage, hiddenLayerSize, numLabels);
+        std::vector<int> order(trainTestSize);
+        for (int i = 0; i < trainTestSize; i++)
+        {
+            order[i] = i;
+        }
+        augment::SplitMix64 shuffleRng(seed);
+        std::vector<double> layer_0(pixelsPerImage); // Shape (1, 784)
+
+        std::cout << "Ensemble: " << ensembleSize << " models, Wide Layer: (" << pixelsPerImage << ", " << ensembleSize * hiddenLayerSize << ")" << std::endl;
+
+        for (int epoch = 0; epoch < epochs; epoch++)
+        {
+            std::vector<double> error(ensembleSize, 0.0);
+            std::vector<int> correct_count(ensembleSize, 0);
+
+            // Fisher-Yates shuffle, identical for every model
+            for (int i = trainTestSize - 1; i > 0; i--)
+            {
+                std::swap(order[i], order[shuffleRng.next() % (i + 1)]);
+            }
+
+            for (int sample = 0; sample < samplesPerEpoch; sample++)
+            {
+                int i;
+                if (augmented)
+                {
+                    i = augmented->next(augmentedPixels);
+                    normalizePixels(augmentedPixels, layer_0);
+                }
+                else
+                {
+                    i = order[sample];
+                    normalizePixels(rowImages.images[i], layer_0);
+                }
+
+                mlmath::Matrix target = labels[i].transpose(); // Shape (1, 10)
+                std::vector<mlmath::Matrix> outputs = ensemble.train(layer_0, target, alpha);
+                for (int m = 0; m < ensembleSize; m++)
+                {
+                    error[m] += ((target - outputs[m]) ^ 2.0).sum();
+                    correct_count[m] += mlmath::argmax(outputs[m]) == mlmath::argmax(labels[i]);
+                }
+            }
+
+            std::cout << "Epoch: " << epoch << " Error:";
+            for (int m = 0; m < ensembleSize; m++)
+            {
+                std::cout << " " << error[m] / samplesPerEpoch;
+            }
+            std::cout << " Accuracy:";
+            for (int m = 0; m < ensembleSize; m++)
+            {
+                std::cout << " " << (double)correct_count[m] / samplesPerEpoch;
+            }
+            std::cout << std::endl;
+        }
+
+        // held-out images right after the training images
+        const int testSize = std::min(1000, rowImages.numImages - trainTestSize);
+        std::vector<int> modelCorrect(ensembleSize, 0);
+        int ensembleCorrect = 0;
+        for (int i = trainTestSize; i < trainTestSize + testSize; i++)
+        {
+            normalizePixels(rowImages.images[i], layer_0);
+            std::vector<mlmath::Matrix> outputs = ensemble.predict(layer_0);
+            mlmath::Matrix combined = mlmath::Matrix::zeros(1, numLabels);
+            for (int m = 0; m < ensembleSize; m++)
+            {
+                modelCorrect[m] += mlmath::argmax(outputs[m]) == rowLabels.labels[i];
+                combined += outputs[m];
+            }
+            ensembleCorrect += mlmath::argmax(combined) == rowLabels.labels[i];
+        }
+        if (testSize > 0)
+        {
+            std::cout << "Test Accuracy (" << testSize << " images):";
+            for (int m = 0; m < ensembleSize; m++)
+            {
+                std::cout << " " << (double)modelCorrect[m] / testSize;
+            }
+            std::cout << " Ensemble: " << (double)ensembleCorrect / testSize << std::endl;
+        }
+
+        // throughput of one epoch: K separate single-model runs vs one ensemble pass from fresh weights
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int m = 0; m < ensembleSize; m++)
+        {
+            nn::Network network(pixelsPerImage, hiddenLayerSize, numLabels);
+            for (int i = 0; i < trainTestSize; i++)
+            {
+                trainSample(network, images[i].reshape(1, pixelsPerImage) / 255.0, labels[i].transpose(), alpha);
+            }
+        }
+        double sequentialSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        nn::Ensemble benchmark(ensembleSize, pixelsPerImage, hiddenLayerSize, numLabels);
+        for (int i = 0; i < trainTestSize; i++)
+        {
+            normalizePixels(rowImages.images[i], layer_0);
+            benchmark.train(layer_0, labels[i].transpose(), alpha);
+        }
+        double ensembleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Model-samples/s: Sequential: " << ensembleSize * trainTestSize / sequentialSeconds
+                  << " Ensemble: " << ensembleSize * trainTestSize / ensembleSeconds
+                  << " Speedup: " << sequentialSeconds / ensembleSeconds << "x" << std::endl;
+        return 0;
+    }
+
+    const std::string weightsPath = "weights.bin";
+
+    nn::Network network(pixelsPerImage, hiddenLayerSize, numLabels);
+
+    // masks depend only on (seed, sample number), never on the order they are generated in
+    std::unique_ptr<dropout::Mask> mask;
+    if (dropProbability > 0.0)
+    {
+        mask.reset(new dropout::Mask(hiddenLayerSize, dropProbability, seed));
+        std::cout << "Dropout: " << dropProbability << " Seed: " << seed << std::endl;
+    }
 
     for (int epoch = 0; epoch < epochs; epoch++)
     {
         double error = 0.0;
         int correct_count = 0;
+        std::chrono::steady_clock::time_point epochStart = std::chrono::steady_clock::now();
+        augment::AugmentedStream::Stats epochStartStats = augmented ? augmented->getStats() : augment::AugmentedStream::Stats();
 
-        for (int i = 0; i < trainTestSize; i++)
+        for (int sample = 0; sample < samplesPerEpoch; sample++)
         {
-            // Forward pass
-            mlmath::Matrix layer_0 = images[i].reshape(1, pixelsPerImage) / 255.0; // Shape (1, 784)
-            mlmath::Matrix layer_1 = layer_0 * weights_0_1;                        // Shape (1, 40)
-            layer_1 = mlmath::relu(layer_1);
-            mlmath::Matrix layer_2 = layer_1 * weights_1_2; // Shape (1, 10)
+            int i = sample;
+            mlmath::Matrix layer_0(1, pixelsPerImage);
+            if (augmented)
+            {
+                i = augmented->next(augmentedPixels);
+                layer_0 = pixelsToRow(augmentedPixels); // Shape (1, 784)
+            }
+            else
+            {
+                layer_0 = images[i].reshape(1, pixelsPerImage) / 255.0; // Shape (1, 784)
+            }
+
+            if (mask)
+            {
+                mask->generate((unsigned long)epoch * samplesPerEpoch + sample);
+            }
 
-            // Error calculation
             mlmath::Matrix target = labels[i].transpose(); // Shape (1, 10)
+            mlmath::Matrix layer_2 = trainSample(network, layer_0, target, alpha, mask.get());
+
+            // Error calculation
             error += ((target - layer_2) ^ 2.0).sum();
             correct_count += mlmath::argmax(layer_2) == mlmath::argmax(labels[i]);
+        }
 
-            // Backpropagation
-            mlmath::Matrix layer_2_delta = layer_2 - target;                         // Shape (1, 10)
-            mlmath::Matrix layer_1_delta = (layer_2_delta * weights_1_2.transpose()) // Shape (1, 40)
-                                               .elementWiseMultiply(mlmath::relu_derivative(layer_1));
+        // print the number of epoch with error and accuracy divided by samplesPerEpoch
+        std::cout << "Epoch: " << epoch << " Error: " << error / samplesPerEpoch << " Accuracy: " << (double)correct_count / samplesPerEpoch << std::endl;
 
-            // Weight updates
-            weights_1_2 -= (layer_1.transpose() * layer_2_delta) * alpha; // Shape (40, 10)
-            weights_0_1 -= (layer_0.transpose() * layer_1_delta) * alpha; // Shape (784, 40)
+        if (augmented)
+        {
+            // capacity is what the workers could sustain if never throttled by the trainer
+            augment::AugmentedStream::Stats stats = augmented->getStats();
+            double epochSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+            double workerSeconds = stats.workerSeconds - epochStartStats.workerSeconds;
+            unsigned long produced = stats.produced - epochStartStats.produced;
+            std::cout << "    Augmented images/s: " << samplesPerEpoch / epochSeconds
+                      << " Capacity images/s: " << (workerSeconds > 0 ? produced / workerSeconds * augmentThreads : 0.0)
+                      << " Trainer waited: " << (stats.waitSeconds - epochStartStats.waitSeconds) * 1000.0 << " ms" << std::endl;
         }
+    }
 
-        // print the number of epoch with error and accuracy divided by trainTestSize
-        std::cout << "Epoch: " << epoch << " Error: " << error / trainTestSize << " Accuracy: " << (double)correct_count / trainTestSize << std::endl;
+    if (mask)
+    {
+        // overhead of one epoch with dropout over one without, both from fresh weights, best of 3 alternating runs
+        double seconds[2] = {1e30, 1e30};
+        for (int run = 0; run < 6; run++)
+        {
+            const int withDropout = run % 2;
+            nn::Network benchmark(pixelsPerImage, hiddenLayerSize, numLabels);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (int i = 0; i < trainTestSize; i++)
+            {
+                if (withDropout)
+                {
+                    mask->generate(i);
+                }
+                trainSample(benchmark, images[i].reshape(1, pixelsPerImage) / 255.0, labels[i].transpose(), alpha,
+                            withDropout ? mask.get() : nullptr);
+            }
+            seconds[withDropout] = std::min(seconds[withDropout], std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        // mask generation alone, per sample
+        const int maskSamples = 1000000;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < maskSamples; i++)
+        {
+            mask->generate(i);
+        }
+        double maskSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Epoch time without dropout: " << seconds[0] * 1000.0 << " ms With dropout: " << seconds[1] * 1000.0
+                  << " ms Overhead: " << (seconds[1] / seconds[0] - 1.0) * 100.0 << "%"
+                  << " Mask generation: " << maskSeconds / maskSamples * 1e9 << " ns/sample" << std::endl;
     }
+
+    // save the trained weights so mnist_server can load them
+    network.save(weightsPath);
+    std::cout << "Saved weights to " << weightsPath << std::endl;
     return 0;
 }
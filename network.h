@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include "mlmath.h"
+
+namespace nn
+{
+    // The two-layer network trained in main.cpp: input -> relu hidden layer -> output
+    class Network
+    {
+    public:
+        mlmath::Matrix weights_0_1; // Shape (pixelsPerImage, hiddenLayerSize)
+        mlmath::Matrix weights_1_2; // Shape (hiddenLayerSize, numLabels)
+
+        Network(unsigned int pixelsPerImage, unsigned int hiddenLayerSize, unsigned int numLabels)
+            : weights_0_1(mlmath::Matrix::random(pixelsPerImage, hiddenLayerSize, -0.1, 0.1)),
+              weights_1_2(mlmath::Matrix::random(hiddenLayerSize, numLabels, -0.1, 0.1))
+        {
+        }
+
+        // Forward pass over a batch, one normalized image per row: (batch, pixels) -> (batch, labels)
+        mlmath::Matrix forward(const mlmath::Matrix &layer_0) const
+        {
+            mlmath::Matrix layer_1 = mlmath::relu(layer_0 * weights_0_1);
+            return layer_1 * weights_1_2;
+        }
+
+        // Save both weight matrices as (rows, cols) followed by the row-major values
+        void save(const std::string &filename) const
+        {
+            std::ofstream file(filename, std::ios::binary);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Cannot open file `" + filename + "`");
+            }
+
+            writeMatrix(file, weights_0_1);
+            writeMatrix(file, weights_1_2);
+        }
+
+        static Network load(const std::string &filename)
+        {
+            std::ifstream file(filename, std::ios::binary);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Cannot open file `" + filename + "`");
+            }
+
+            mlmath::Matrix weights_0_1 = readMatrix(file);
+            mlmath::Matrix weights_1_2 = readMatrix(file);
+            if (weights_0_1.shape.cols != weights_1_2.shape.rows)
+            {
+                throw std::runtime_error("Invalid weights file `" + filename + "`");
+            }
+            return Network(weights_0_1, weights_1_2);
+        }
+
+    private:
+        Network(const mlmath::Matrix &weights_0_1, const mlmath::Matrix &weights_1_2)
+            : weights_0_1(weights_0_1), weights_1_2(weights_1_2)
+        {
+        }
+
+        static void writeMatrix(std::ofstream &file, const mlmath::Matrix &matrix)
+        {
+            uint32_t shape[2] = {matrix.shape.rows, matrix.shape.cols};
+            file.write(reinterpret_cast<const char *>(shape), sizeof(shape));
+            for (unsigned int i = 0; i < matrix.shape.rows; i++)
+            {
+                file.write(reinterpret_cast<const char *>(matrix.data[i].data()), matrix.shape.cols * sizeof(double));
+            }
+        }
+
+        static mlmath::Matrix readMatrix(std::ifstream &file)
+        {
+            uint32_t shape[2] = {0, 0};
+            file.read(reinterpret_cast<char *>(shape), sizeof(shape));
+            if (!file || shape[0] == 0 || shape[1] == 0)
+            {
+                throw std::runtime_error("Invalid weights file!");
+            }
+
+            mlmath::Matrix matrix(shape[0], shape[1]);
+            for (unsigned int i = 0; i < matrix.shape.rows; i++)
+            {
+                file.read(reinterpret_cast<char *>(matrix.data[i].data()), matrix.shape.cols * sizeof(double));
+            }
+            if (!file)
+            {
+                throw std::runtime_error("Invalid weights file!");
+            }
+            return matrix;
+        }
+    };
+}
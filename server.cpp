@@ -0,0 +1,210 @@
+#include <iostream>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <csignal>
+#include <cstdlib>
+#include "mlmath.h"
+#include "network.h"
+#include "serving.h"
+
+// Coalesces concurrent requests into micro-batches and runs one batched forward pass per batch.
+// A batch is flushed as soon as it holds maxBatchSize requests or its oldest request has waited maxWait.
+class MicroBatcher
+{
+public:
+    MicroBatcher(const nn::Network &network, unsigned int maxBatchSize, std::chrono::microseconds maxWait)
+        : network(network), maxBatchSize(maxBatchSize), maxWait(maxWait)
+    {
+    }
+
+    std::future<serving::Response> submit(const std::vector<unsigned char> &pixels)
+    {
+        Request request;
+        request.pixels = pixels;
+        request.arrival = std::chrono::steady_clock::now();
+        std::future<serving::Response> reply = request.reply.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(request));
+        }
+        ready.notify_one();
+        return reply;
+    }
+
+    // Batching loop, runs on its own thread for the lifetime of the server
+    void run()
+    {
+        std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+        unsigned long servedRequests = 0;
+        unsigned long servedBatches = 0;
+
+        while (true)
+        {
+            std::vector<Request> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this]
+                           { return !queue.empty(); });
+
+                // hold the batch open until it is full or the oldest request reaches its deadline
+                std::chrono::steady_clock::time_point deadline = queue.front().arrival + maxWait;
+                ready.wait_until(lock, deadline, [this]
+                                 { return queue.size() >= maxBatchSize; });
+
+                unsigned int batchSize = std::min<size_t>(queue.size(), maxBatchSize);
+                for (unsigned int i = 0; i < batchSize; i++)
+                {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+
+            process(batch);
+
+            servedRequests += batch.size();
+            servedBatches++;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now - lastReport >= std::chrono::seconds(5))
+            {
+                std::cout << "Served " << servedRequests << " requests in " << servedBatches
+                          << " batches (avg batch size " << (double)servedRequests / servedBatches << ")" << std::endl;
+                lastReport = now;
+                servedRequests = 0;
+                servedBatches = 0;
+            }
+        }
+    }
+
+private:
+    struct Request
+    {
+        std::vector<unsigned char> pixels;
+        std::chrono::steady_clock::time_point arrival;
+        std::promise<serving::Response> reply;
+    };
+
+    const nn::Network &network;
+    const unsigned int maxBatchSize;
+    const std::chrono::microseconds maxWait;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Request> queue;
+
+    void process(std::vector<Request> &batch)
+    {
+        mlmath::Matrix layer_0(batch.size(), serving::imageBytes); // Shape (batch, 784)
+        for (unsigned int i = 0; i < batch.size(); i++)
+        {
+            for (unsigned int j = 0; j < serving::imageBytes; j++)
+            {
+                layer_0.data[i][j] = batch[i].pixels[j] / 255.0;
+            }
+        }
+
+        mlmath::Matrix layer_2 = network.forward(layer_0); // Shape (batch, 10)
+
+        for (unsigned int i = 0; i < batch.size(); i++)
+        {
+            serving::Response response;
+            response.label = (unsigned char)mlmath::argmax(layer_2.data[i]);
+            for (unsigned int j = 0; j < serving::numLabels; j++)
+            {
+                response.scores[j] = (float)layer_2.data[i][j];
+            }
+            batch[i].reply.set_value(response);
+        }
+    }
+};
+
+// Serve one client connection: read an image, wait for its batch, write the reply, repeat until EOF
+void serveConnection(int fd, MicroBatcher &batcher)
+{
+    std::vector<unsigned char> pixels(serving::imageBytes);
+    unsigned char buffer[serving::responseBytes];
+
+    while (serving::readFully(fd, pixels.data(), pixels.size()))
+    {
+        serving::Response response = batcher.submit(pixels).get();
+        response.serialize(buffer);
+        if (!serving::writeFully(fd, buffer, sizeof(buffer)))
+        {
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--weights PATH] [--socket PATH] [--max-batch N] [--max-wait-us N]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::string weightsPath = "weights.bin";
+    std::string socketPath = serving::defaultSocketPath;
+    unsigned int maxBatchSize = 32;
+    unsigned int maxWaitMicros = 500;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (arg == "--weights")
+            weightsPath = argv[++i];
+        else if (arg == "--socket")
+            socketPath = argv[++i];
+        else if (arg == "--max-batch")
+            maxBatchSize = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--max-wait-us")
+            maxWaitMicros = std::max(0, std::atoi(argv[++i]));
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // a client hanging up mid-reply must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    nn::Network network = nn::Network::load(weightsPath);
+    if (network.weights_0_1.shape.rows != serving::imageBytes || network.weights_1_2.shape.cols != serving::numLabels)
+    {
+        std::cerr << "Weights in `" << weightsPath << "` do not match a 784 -> 10 classifier" << std::endl;
+        return 1;
+    }
+
+    MicroBatcher batcher(network, maxBatchSize, std::chrono::microseconds(maxWaitMicros));
+    std::thread batchThread(&MicroBatcher::run, &batcher);
+    batchThread.detach();
+
+    int listenFd = serving::listenUnix(socketPath);
+    std::cout << "Listening on " << socketPath << " Max Batch: " << maxBatchSize << " Max Wait (us): " << maxWaitMicros << std::endl;
+
+    while (true)
+    {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        std::thread(serveConnection, fd, std::ref(batcher)).detach();
+    }
+
+    ::close(listenFd);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Wire protocol shared by mnist_server and mnist_loadgen.
+// A request is one raw 28x28 image (784 bytes, row-major, 0-255).
+// A response is the predicted class (1 byte) followed by the 10 output scores (float32, host byte order).
+namespace serving
+{
+    const std::string defaultSocketPath = "/tmp/mnist-classifier.sock";
+    const unsigned int imageBytes = 784;
+    const unsigned int numLabels = 10;
+    const unsigned int responseBytes = 1 + numLabels * sizeof(float);
+
+    struct Response
+    {
+        unsigned char label;
+        float scores[numLabels];
+
+        void serialize(unsigned char *buffer) const
+        {
+            buffer[0] = label;
+            std::memcpy(buffer + 1, scores, sizeof(scores));
+        }
+
+        static Response deserialize(const unsigned char *buffer)
+        {
+            Response response;
+            response.label = buffer[0];
+            std::memcpy(response.scores, buffer + 1, sizeof(response.scores));
+            return response;
+        }
+    };
+
+    // Read exactly `size` bytes, returns false if the peer closed the connection first
+    inline bool readFully(int fd, void *buffer, size_t size)
+    {
+        char *out = static_cast<char *>(buffer);
+        while (size > 0)
+        {
+            ssize_t n = ::read(fd, out, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            out += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    // Write exactly `size` bytes, returns false if the connection broke
+    inline bool writeFully(int fd, const void *buffer, size_t size)
+    {
+        const char *in = static_cast<const char *>(buffer);
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, in, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            in += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    inline sockaddr_un socketAddress(const std::string &path)
+    {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Socket path is too long: `" + path + "`");
+        }
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    inline int listenUnix(const std::string &path)
+    {
+        sockaddr_un address = socketAddress(path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+        }
+
+        ::unlink(path.c_str()); // remove a stale socket left behind by a previous run
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0)
+        {
+            std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Cannot listen on `" + path + "`: " + error);
+        }
+        return fd;
+    }
+
+    inline int connectUnix(const std::string &path)
+    {
+        sockaddr_un address = socketAddress(path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot create socket: " + std::string(std::strerror(errno)));
+        }
+
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+        {
+            std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Cannot connect to `" + path + "`: " + error);
+        }
+        return fd;
+    }
+}